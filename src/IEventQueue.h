@@ -0,0 +1,149 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Entity Events Queue
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _INCLUDE_EVENTQUEUE_INTERFACE_H_
+#define _INCLUDE_EVENTQUEUE_INTERFACE_H_
+
+/**
+ * @file IEventQueue.h
+ * @brief Interface for other extensions to access the entity events queue.
+ *
+ * Request it with sharesys->RequestInterface(SMINTERFACE_EVENTQUEUE_NAME,
+ * SMINTERFACE_EVENTQUEUE_VERSION, myself, ...). Strings passed in are copied,
+ * the queue never keeps pointers to caller memory.
+ */
+
+#include <IShareSys.h>
+
+#define SMINTERFACE_EVENTQUEUE_NAME		"IEventQueue"
+#define SMINTERFACE_EVENTQUEUE_VERSION	1
+
+class CBaseEntity;
+class variant_t;
+
+class IEventQueue : public SourceMod::SMInterface
+{
+public:
+	virtual const char *GetInterfaceName() { return SMINTERFACE_EVENTQUEUE_NAME; }
+	virtual unsigned int GetInterfaceVersion() { return SMINTERFACE_EVENTQUEUE_VERSION; }
+public:
+	/**
+	 * @brief Adds the event into the correct spot in the priority queue, targeting entity via pointer.
+	 *
+	 * @param pTarget		Target entity.
+	 * @param sInput		Input name.
+	 * @param sParam		Input parameter, or NULL for none.
+	 * @param flDelay		Input delay.
+	 * @param pActivator	Input activator, may be NULL.
+	 * @param pCaller		Input caller, may be NULL.
+	 * @param iOutputID		Output ID.
+	 */
+	virtual void AddEvent(CBaseEntity *pTarget, const char *sInput, const char *sParam, float flDelay, CBaseEntity *pActivator, CBaseEntity *pCaller, int iOutputID = 0) =0;
+
+	/**
+	 * @brief Same as above, with a typed input parameter.
+	 */
+	virtual void AddEvent(CBaseEntity *pTarget, const char *sInput, const variant_t &value, float flDelay, CBaseEntity *pActivator, CBaseEntity *pCaller, int iOutputID = 0) =0;
+
+	/**
+	 * @brief Adds the event into the correct spot in the priority queue, targeting entity via string name.
+	 *
+	 * @param sTarget		Target name (could be full entity's name or wildcard or classname).
+	 * @param sInput		Input name.
+	 * @param sParam		Input parameter, or NULL for none.
+	 * @param flDelay		Input delay.
+	 * @param pActivator	Input activator, may be NULL.
+	 * @param pCaller		Input caller, may be NULL.
+	 * @param iOutputID		Output ID.
+	 */
+	virtual void AddEventByName(const char *sTarget, const char *sInput, const char *sParam, float flDelay, CBaseEntity *pActivator, CBaseEntity *pCaller, int iOutputID = 0) =0;
+
+	/**
+	 * @brief Same as above, with a typed input parameter.
+	 */
+	virtual void AddEventByName(const char *sTarget, const char *sInput, const variant_t &value, float flDelay, CBaseEntity *pActivator, CBaseEntity *pCaller, int iOutputID = 0) =0;
+
+	/**
+	 * @brief Removes all pending events of the specified type from the queue of the target.
+	 *
+	 * @param pTarget		Target entity.
+	 * @param sInput		Input name (could be wildcard), or NULL for all inputs.
+	 */
+	virtual void CancelEventOn(CBaseEntity *pTarget, const char *sInput) =0;
+
+	/**
+	 * @brief Removes all pending events that were added by the given caller.
+	 *
+	 * @param pCaller		Caller entity.
+	 */
+	virtual void CancelEvents(CBaseEntity *pCaller) =0;
+
+	/**
+	 * @brief Checks if the target has specified pending inputs.
+	 *
+	 * @param pTarget		Target entity.
+	 * @param sInput		Input name (could be wildcard), or NULL for any input.
+	 * @return				True if the target has specified pending inputs.
+	 */
+	virtual bool HasEventPending(CBaseEntity *pTarget, const char *sInput) =0;
+
+	/**
+	 * @brief Checks which of the targets have specified pending inputs, walking the queue only once.
+	 *
+	 * @param pTargets		Target entities, NULL entries are never pending.
+	 * @param iCount		Number of targets.
+	 * @param sInput		Input name (could be wildcard), or NULL for any input.
+	 * @param pResults		Receives for each target whether it has specified pending inputs.
+	 * @return				Number of targets that have specified pending inputs.
+	 */
+	virtual int HasEventPendingMulti(CBaseEntity **pTargets, int iCount, const char *sInput, bool *pResults) =0;
+
+	/**
+	 * @brief Shifts the fire time of the pending events of the target without re-adding them.
+	 * Events that are already due are skipped, they may be firing right now.
+	 * Paused events get the delay they will have once resumed shifted instead.
+	 *
+	 * @param pTarget		Target entity.
+	 * @param sInput		Input name (could be wildcard), or NULL for any input.
+	 * @param flDelta		Seconds to add to the fire time (could be negative).
+	 * @return				Number of rescheduled events.
+	 */
+	virtual int RescheduleEvents(CBaseEntity *pTarget, const char *sInput, float flDelta) =0;
+
+	/**
+	 * @brief Takes the pending events of the target out of the queue, keeping their remaining delay.
+	 * Events that are already due are skipped, they may be firing right now.
+	 *
+	 * @param pTarget		Target entity.
+	 * @param sInput		Input name (could be wildcard), or NULL for any input.
+	 * @return				Number of paused events.
+	 */
+	virtual int PauseEvents(CBaseEntity *pTarget, const char *sInput) =0;
+
+	/**
+	 * @brief Puts the paused events of the target back into the queue with their remaining delay.
+	 *
+	 * @param pTarget		Target entity.
+	 * @param sInput		Input name (could be wildcard), or NULL for any input.
+	 * @return				Number of resumed events.
+	 */
+	virtual int ResumeEvents(CBaseEntity *pTarget, const char *sInput) =0;
+};
+
+#endif // _INCLUDE_EVENTQUEUE_INTERFACE_H_
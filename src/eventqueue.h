@@ -59,11 +59,27 @@ public:
 	void CancelEvents( CBaseEntity *pCaller );
 	void CancelEventOn( CBaseEntity *pTarget, const char *sInputName );
 	bool HasEventPending( CBaseEntity *pTarget, const char *sInputName );
+	int HasEventPendingMulti( CBaseEntity **pTargets, int iCount, const char *sInputName, bool *pResults );
+
+	// shifts the fire time of matching events in place, returns how many were moved
+	// events that are already due are left alone, they may be firing right now
+	int RescheduleEvents( CBaseEntity *pTarget, const char *sInputName, float flDelta );
+	// parks matching events outside of the queue without freeing them
+	int PauseEvents( CBaseEntity *pTarget, const char *sInputName );
+	int ResumeEvents( CBaseEntity *pTarget, const char *sInputName );
+	void ResumeAllEvents();
+	void ClearPausedEvents();
+	int GetEventCount();
 
 private:
 
 	void AddEvent( EventQueuePrioritizedEvent_t *event );
 	void RemoveEvent( EventQueuePrioritizedEvent_t *pe );
+	void MergeEvents( EventQueuePrioritizedEvent_t *pChain );
+	static bool IsEventFor( EventQueuePrioritizedEvent_t *pe, CBaseEntity *pTarget, const char *sTargetName, const char *sTargetClassname, const char *sInputName, const char *ich );
+	static EventQueuePrioritizedEvent_t *SkipDueEvents( EventQueuePrioritizedEvent_t *pe );
+	static bool IsEventFrom( EventQueuePrioritizedEvent_t *pe, CBaseEntity *pCaller );
+	static bool IsInputFor( EventQueuePrioritizedEvent_t *pe, const char *sInputName, const char *ich );
 
 	DECLARE_SIMPLE_DATADESC();
 	EventQueuePrioritizedEvent_t m_Events;
@@ -33,8 +33,14 @@
 #include "isaverestore.h"
 #include "variant_t.h"
 #include "eventqueue.h"
+#include "flightrecorder.h"
+#include "IEventQueue.h"
 #include "CDetour/detours.h"
 #include <list>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <cmath>
 
 using AddressPool = std::list<EventQueuePrioritizedEvent_t*>;
 EventQueue g_EventQueueExt;		/**< Global singleton for extension's main interface */
@@ -45,7 +51,18 @@ IGameConfig *g_pGameConf = NULL;
 CGlobalVars *gpGlobals = NULL;
 CBaseEntityList *g_pEntityList = NULL;
 CDetour* g_EventQueueRemove = NULL;
+CDetour* g_EventQueueAlloc = NULL;
+CDetour* g_EventQueueClear = NULL;
+ICvar *icvar = NULL;
+bool g_bCancelling = false;		/**< Set while this extension frees events, so the recorder doesn't log them as dispatched */
+double g_flFrameStart = 0.0;
 static AddressPool EventData;
+static AddressPool PausedEvents;
+
+SH_DECL_HOOK0_void(IServerGameDLL, LevelShutdown, SH_NOATTRIB, false);
+SH_DECL_HOOK1_void(IServerGameDLL, GameFrame, SH_NOATTRIB, false, bool);
+
+ConVar g_cvRecorderSpike("sm_eventqueue_recorder_spike_ms", "0", FCVAR_NONE, "Records recent event queue activity and writes it to the SourceMod logs folder when a server frame spends longer than this many milliseconds in its own work, never less than one tick (0 = disabled)", true, 0.0, false, 0.0);
 
 
 inline const char* MakeStrCopy(const char* s, size_t len)
@@ -85,16 +102,74 @@ void OnEventRemove(EventQueuePrioritizedEvent_t * event)
 	}
 }
 
+inline void RecordEvent(FlightRecorderOp_t op, EventQueuePrioritizedEvent_t* event)
+{
+	if(!g_FlightRecorder.IsEnabled())
+		return;
+	int iTarget = event->m_pEntTarget.IsValid() ? event->m_pEntTarget.GetEntryIndex() : -1;
+	g_FlightRecorder.Record(op, iTarget, STRING(event->m_iTarget), STRING(event->m_iTargetInput), event->m_flFireTime);
+}
+
+//Turns parked events back into absolute fire times and links them into a sorted chain
+EventQueuePrioritizedEvent_t* MakeResumedChain(AddressPool& events)
+{
+	for(auto event : events)
+		event->m_flFireTime += gpGlobals->curtime;
+
+	//Events paused at different times are not ordered by remaining delay
+	events.sort([](const EventQueuePrioritizedEvent_t* a, const EventQueuePrioritizedEvent_t* b) { return a->m_flFireTime < b->m_flFireTime; });
+
+	EventQueuePrioritizedEvent_t* pChain = NULL;
+	EventQueuePrioritizedEvent_t** ppTail = &pChain;
+	for(auto event : events)
+	{
+		event->m_pNext = NULL;
+		*ppTail = event;
+		ppTail = &event->m_pNext;
+	}
+	return pChain;
+}
+
 DETOUR_DECL_STATIC2(CEventQueueRemove, void, CUtlMemoryPool*, Allocator, void*, p)
 {
 	if(Allocator == EventQueuePrioritizedEvent_t::s_Allocator)
 	{
 		EventQueuePrioritizedEvent_t* Event = (EventQueuePrioritizedEvent_t*)p;
+		g_FlightRecorder.OnFree();
+		RecordEvent(g_bCancelling ? FlightRecorder_Cancel : FlightRecorder_Dispatch, Event);
 		OnEventRemove(Event);
 	}
 	DETOUR_STATIC_CALL(CEventQueueRemove)(Allocator, p);
 }
 
+DETOUR_DECL_STATIC2(CEventQueueAlloc, void*, CUtlMemoryPool*, Allocator, size_t, size)
+{
+	if(Allocator == EventQueuePrioritizedEvent_t::s_Allocator)
+		g_FlightRecorder.OnAlloc();
+	return DETOUR_STATIC_CALL(CEventQueueAlloc)(Allocator, size);
+}
+
+void Hook_GameFrame(bool simulating)
+{
+	g_flFrameStart = Plat_FloatTime();
+	RETURN_META(MRES_IGNORED);
+}
+
+//Only the frame's own work is timed, the engine's sleep between ticks and our dumps are not
+void Hook_GameFramePost(bool simulating)
+{
+	float flThreshold = g_cvRecorderSpike.GetFloat();
+	g_FlightRecorder.SetEnabled(flThreshold > 0.0f);
+	if(g_FlightRecorder.IsEnabled())
+	{
+		double flNow = Plat_FloatTime();
+		//A frame that fits in its tick is not a spike
+		float flTickMs = gpGlobals->interval_per_tick * 1000.0f;
+		g_FlightRecorder.OnFrame((flNow - g_flFrameStart) * 1000.0, flThreshold > flTickMs ? flThreshold : flTickMs, flNow);
+	}
+	RETURN_META(MRES_IGNORED);
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: private function, adds an event into the list
 // Input  : *newEvent - the (already built) event to add
@@ -102,6 +177,7 @@ DETOUR_DECL_STATIC2(CEventQueueRemove, void, CUtlMemoryPool*, Allocator, void*,
 void CEventQueue::AddEvent( EventQueuePrioritizedEvent_t *newEvent )
 {
 	EventData.push_back(newEvent);
+	RecordEvent(FlightRecorder_Add, newEvent);
 	// loop through the actions looking for a place to insert
 	EventQueuePrioritizedEvent_t *pe;
 	for ( pe = &m_Events; pe->m_pNext != NULL; pe = pe->m_pNext )
@@ -131,6 +207,96 @@ void CEventQueue::RemoveEvent( EventQueuePrioritizedEvent_t *pe )
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: private function, links a chain of events into the list
+// Input  : *pChain - events linked through m_pNext, sorted by fire time
+//-----------------------------------------------------------------------------
+void CEventQueue::MergeEvents( EventQueuePrioritizedEvent_t *pChain )
+{
+	EventQueuePrioritizedEvent_t *pe = &m_Events;
+	while ( pChain != NULL )
+	{
+		EventQueuePrioritizedEvent_t *newEvent = pChain;
+		pChain = pChain->m_pNext;
+
+		// the chain is sorted, so keep walking from the last insertion point
+		while ( pe->m_pNext != NULL && pe->m_pNext->m_flFireTime <= newEvent->m_flFireTime )
+		{
+			pe = pe->m_pNext;
+		}
+
+		newEvent->m_pNext = pe->m_pNext;
+		newEvent->m_pPrev = pe;
+		pe->m_pNext = newEvent;
+		if ( newEvent->m_pNext )
+		{
+			newEvent->m_pNext->m_pPrev = newEvent;
+		}
+		pe = newEvent;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: private function, return true if the event targets pTarget with
+//			the given input
+// Input  : *sInputName - NULL for any input, or a specified one (could be wildcard)
+//			*ich - position of the wildcard in sInputName, or NULL
+//-----------------------------------------------------------------------------
+bool CEventQueue::IsEventFor( EventQueuePrioritizedEvent_t *pe, CBaseEntity *pTarget, const char *sTargetName, const char *sTargetClassname, const char *sInputName, const char *ich )
+{
+	const char* sTarget = STRING(pe->m_iTarget);
+	const char* ch = sTarget ? strchr(sTarget, '*') : NULL;
+	if ( pe->m_pEntTarget == pTarget || 
+		(!pe->m_pEntTarget && sTarget && sTargetName && 
+		((ch && strlen(sTargetName) >= strlen(sTarget) - 1 && !Q_strncmp(sTarget, sTargetName, ch - sTarget)) ||
+		(!ch && (!stricmp(sTarget, sTargetName) || !stricmp(sTarget, sTargetClassname))))) )
+	{
+		return IsInputFor( pe, sInputName, ich );
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: private function, return the first event that is not due yet.
+//			ServiceEvents keeps the event it is firing linked until the input
+//			returns, so due events must never be unlinked from inside an input.
+//-----------------------------------------------------------------------------
+EventQueuePrioritizedEvent_t *CEventQueue::SkipDueEvents( EventQueuePrioritizedEvent_t *pe )
+{
+	while ( pe != NULL && pe->m_flFireTime <= gpGlobals->curtime )
+	{
+		pe = pe->m_pNext;
+	}
+	return pe;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: private function, return true if the event was added by pCaller
+//-----------------------------------------------------------------------------
+bool CEventQueue::IsEventFrom( EventQueuePrioritizedEvent_t *pe, CBaseEntity *pCaller )
+{
+	if (pe->m_pCaller != pCaller)
+		return false;
+
+	// Pointers match; make sure everything else matches.
+	return !stricmp(STRING(GetEntityName(pe->m_pCaller)), STRING(GetEntityName(pCaller))) &&
+		!stricmp(gamehelpers -> GetEntityClassname(pe->m_pCaller), gamehelpers -> GetEntityClassname(pCaller));
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: private function, return true if the event fires the given input
+// Input  : *sInputName - NULL for any input, or a specified one (could be wildcard)
+//			*ich - position of the wildcard in sInputName, or NULL
+//-----------------------------------------------------------------------------
+bool CEventQueue::IsInputFor( EventQueuePrioritizedEvent_t *pe, const char *sInputName, const char *ich )
+{
+	const char* sInput = STRING(pe->m_iTargetInput);
+	return !sInputName ||
+		(sInput && ((ich && strlen(sInput) >= strlen(sInputName) - 1 && !Q_strncmp(sInput, sInputName, ich - sInputName)) || 
+		(!ich && !stricmp(sInput, sInputName))));
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: adds the action into the correct spot in the priority queue, targeting entity via string name
 //-----------------------------------------------------------------------------
@@ -187,20 +353,12 @@ void CEventQueue::CancelEvents( CBaseEntity *pCaller )
 		return;
 
 	EventQueuePrioritizedEvent_t *pCur = m_Events.m_pNext;
+	g_bCancelling = true;
 
 	while (pCur != NULL)
 	{
-		bool bDelete = false;
-		if (pCur->m_pCaller == pCaller)
-		{
-			// Pointers match; make sure everything else matches.
-			if (!stricmp(STRING(GetEntityName(pCur->m_pCaller)), STRING(GetEntityName(pCaller))) &&
-				!stricmp(gamehelpers -> GetEntityClassname(pCur->m_pCaller), gamehelpers -> GetEntityClassname(pCaller)))
-			{
-				// Found a matching event; delete it from the queue.
-				bDelete = true;
-			}
-		}
+		// Found a matching event; delete it from the queue.
+		bool bDelete = IsEventFrom( pCur, pCaller );
 
 		EventQueuePrioritizedEvent_t *pCurSave = pCur;
 		pCur = pCur->m_pNext;
@@ -211,6 +369,21 @@ void CEventQueue::CancelEvents( CBaseEntity *pCaller )
 			delete pCurSave;
 		}
 	}
+
+	// Paused events would otherwise fire once resumed
+	for(auto begin = PausedEvents.begin(); begin != PausedEvents.end();)
+	{
+		EventQueuePrioritizedEvent_t *pCurSave = *begin;
+		if ( IsEventFrom( pCurSave, pCaller ) )
+		{
+			begin = PausedEvents.erase(begin);
+			delete pCurSave;
+		}
+		else
+			++begin;
+	}
+
+	g_bCancelling = false;
 }
 
 //-----------------------------------------------------------------------------
@@ -228,26 +401,12 @@ void CEventQueue::CancelEventOn( CBaseEntity *pTarget, const char *sInputName )
 	const char* sTargetName = STRING(GetEntityName(pTarget));
 	const char* sTargetClassname = gamehelpers -> GetEntityClassname(pTarget);
 	const char* ich = sInputName ? strchr(sInputName, '*') : NULL;
+	g_bCancelling = true;
 	
 	while (pCur != NULL)
 	{
-		bool bDelete = false;	
-		const char* sTarget = STRING(pCur->m_iTarget);
-		const char* ch = sTarget ? strchr(sTarget, '*') : NULL;
-		if ( pCur->m_pEntTarget == pTarget || 
-			(!pCur->m_pEntTarget && sTarget && sTargetName && 
-			((ch && strlen(sTargetName) >= strlen(sTarget) - 1 && !Q_strncmp(sTarget, sTargetName, ch - sTarget)) ||
-			(!ch && (!stricmp(sTarget, sTargetName) || !stricmp(sTarget, sTargetClassname))))) )
-		{
-			const char* sInput = STRING(pCur->m_iTargetInput);
-			if (!sInputName ||
-				(sInput && ((ich && strlen(sInput) >= strlen(sInputName) - 1 && !Q_strncmp(sInput, sInputName, ich - sInputName)) || 
-				(!ich && !stricmp(sInput, sInputName)))) )
-			{
-				// Found a matching event; delete it from the queue.
-				bDelete = true;
-			}
-		}
+		// Found a matching event; delete it from the queue.
+		bool bDelete = IsEventFor( pCur, pTarget, sTargetName, sTargetClassname, sInputName, ich );
 
 		EventQueuePrioritizedEvent_t *pCurSave = pCur;
 		pCur = pCur->m_pNext;
@@ -258,6 +417,21 @@ void CEventQueue::CancelEventOn( CBaseEntity *pTarget, const char *sInputName )
 			delete pCurSave;
 		}
 	}
+
+	// Paused events would otherwise fire once resumed
+	for(auto begin = PausedEvents.begin(); begin != PausedEvents.end();)
+	{
+		EventQueuePrioritizedEvent_t *pCurSave = *begin;
+		if ( IsEventFor( pCurSave, pTarget, sTargetName, sTargetClassname, sInputName, ich ) )
+		{
+			begin = PausedEvents.erase(begin);
+			delete pCurSave;
+		}
+		else
+			++begin;
+	}
+
+	g_bCancelling = false;
 }
 
 //-----------------------------------------------------------------------------
@@ -277,30 +451,355 @@ bool CEventQueue::HasEventPending( CBaseEntity *pTarget, const char *sInputName
 	
 	while (pCur != NULL)
 	{
-		const char* sTarget = STRING(pCur->m_iTarget);
-		const char* ch = sTarget ? strchr(sTarget, '*') : NULL;
-		if ( pCur->m_pEntTarget == pTarget || 
-			(!pCur->m_pEntTarget && sTarget && sTargetName && 
-			((ch && strlen(sTargetName) >= strlen(sTarget) - 1 && !Q_strncmp(sTarget, sTargetName, ch - sTarget)) ||
-			(!ch && (!stricmp(sTarget, sTargetName) || !stricmp(sTarget, sTargetClassname))))) )
+		if ( IsEventFor( pCur, pTarget, sTargetName, sTargetClassname, sInputName, ich ) )
+			return true;
+
+		pCur = pCur->m_pNext;
+	}
+
+	// Paused events are still pending, they just don't count down
+	for(auto event : PausedEvents)
+	{
+		if ( IsEventFor( event, pTarget, sTargetName, sTargetClassname, sInputName, ich ) )
+			return true;
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: HasEventPending for several targets in a single pass over the queue.
+//			Requested entities and their names are put in sorted lookup tables,
+//			only wildcard targets have to be compared against every name.
+// Input  : **pTargets - entities to check, NULL entries are never pending
+//			*pResults - receives one result per target
+// Output : number of targets that have a pending input
+//-----------------------------------------------------------------------------
+int CEventQueue::HasEventPendingMulti( CBaseEntity **pTargets, int iCount, const char *sInputName, bool *pResults )
+{
+	typedef std::pair<CBaseEntity*, int> EntityKey_t;
+	typedef std::pair<const char*, int> NameKey_t;
+	std::vector<EntityKey_t> entities;
+	std::vector<NameKey_t> names;		// target names, used for wildcards
+	std::vector<NameKey_t> lookup;		// target names and classnames
+	entities.reserve(iCount);
+	names.reserve(iCount);
+	lookup.reserve(iCount * 2);
+
+	for (int i = 0; i < iCount; i++)
+	{
+		pResults[i] = false;
+		if (!pTargets[i])
+			continue;
+
+		entities.push_back(EntityKey_t(pTargets[i], i));
+		const char* sTargetName = STRING(GetEntityName(pTargets[i]));
+		if (sTargetName)
+		{
+			names.push_back(NameKey_t(sTargetName, i));
+			lookup.push_back(NameKey_t(sTargetName, i));
+			lookup.push_back(NameKey_t(gamehelpers -> GetEntityClassname(pTargets[i]), i));
+		}
+	}
+
+	auto nameLess = [](const NameKey_t &a, const NameKey_t &b) { return stricmp(a.first, b.first) < 0; };
+	std::sort(entities.begin(), entities.end());
+	std::sort(lookup.begin(), lookup.end(), nameLess);
+
+	int iPending = 0;
+	auto markPending = [&](int i)
+	{
+		if (!pResults[i])
+		{
+			pResults[i] = true;
+			iPending++;
+		}
+	};
+
+	const char* ich = sInputName ? strchr(sInputName, '*') : NULL;
+	auto checkEvent = [&](EventQueuePrioritizedEvent_t *pe)
+	{
+		if ( !IsInputFor( pe, sInputName, ich ) )
+			return;
+
+		CBaseEntity *pEntTarget = pe->m_pEntTarget;
+		const char* sTarget = STRING(pe->m_iTarget);
+		if (pEntTarget)
+		{
+			auto it = std::lower_bound(entities.begin(), entities.end(), EntityKey_t(pEntTarget, 0));
+			for (; it != entities.end() && it->first == pEntTarget; ++it)
+				markPending(it->second);
+		}
+		else if (sTarget)
 		{
-			const char* sInput = STRING(pCur->m_iTargetInput);
-			if (!sInputName ||
-				(sInput && ((ich && strlen(sInput) >= strlen(sInputName) - 1 && !Q_strncmp(sInput, sInputName, ich - sInputName)) || 
-				(!ich && !stricmp(sInput, sInputName)))) )
+			const char* ch = strchr(sTarget, '*');
+			if (ch)
+			{
+				for (auto &name : names)
+				{
+					if (strlen(name.first) >= strlen(sTarget) - 1 && !Q_strncmp(sTarget, name.first, ch - sTarget))
+						markPending(name.second);
+				}
+			}
+			else
 			{
-				return true;
+				auto it = std::lower_bound(lookup.begin(), lookup.end(), NameKey_t(sTarget, 0), nameLess);
+				for (; it != lookup.end() && !stricmp(it->first, sTarget); ++it)
+					markPending(it->second);
 			}
 		}
+	};
+
+	for ( EventQueuePrioritizedEvent_t *pCur = m_Events.m_pNext; pCur != NULL && iPending < (int)entities.size(); pCur = pCur->m_pNext )
+		checkEvent( pCur );
+
+	// Paused events are still pending, same as in HasEventPending
+	for ( auto it = PausedEvents.begin(); it != PausedEvents.end() && iPending < (int)entities.size(); ++it )
+		checkEvent( *it );
+
+	return iPending;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Shifts the fire time of the target's matching events by flDelta.
+//			The matching events are unlinked in queue order, so after the shift
+//			they still form a sorted chain and can be merged back in one pass.
+//			Matching paused events get their remaining delay shifted instead.
+//-----------------------------------------------------------------------------
+int CEventQueue::RescheduleEvents( CBaseEntity *pTarget, const char *sInputName, float flDelta )
+{
+	// A NaN fire time would sit at the head of the queue and block it until map change
+	if (!pTarget || !std::isfinite(flDelta))
+		return 0;
+
+	EventQueuePrioritizedEvent_t *pCur = m_Events.m_pNext;
+	const char* sTargetName = STRING(GetEntityName(pTarget));
+	const char* sTargetClassname = gamehelpers -> GetEntityClassname(pTarget);
+	const char* ich = sInputName ? strchr(sInputName, '*') : NULL;
+
+	EventQueuePrioritizedEvent_t *pChain = NULL;
+	EventQueuePrioritizedEvent_t **ppTail = &pChain;
+	int iCount = 0;
 
+	pCur = SkipDueEvents( pCur );
+	while (pCur != NULL)
+	{
+		EventQueuePrioritizedEvent_t *pCurSave = pCur;
 		pCur = pCur->m_pNext;
+
+		if ( IsEventFor( pCurSave, pTarget, sTargetName, sTargetClassname, sInputName, ich ) )
+		{
+			RemoveEvent( pCurSave );
+			pCurSave->m_flFireTime += flDelta;
+			pCurSave->m_pNext = NULL;
+			*ppTail = pCurSave;
+			ppTail = &pCurSave->m_pNext;
+			iCount++;
+		}
 	}
 
-	return false;
+	MergeEvents( pChain );
+
+	// Paused events hold their remaining delay, shift it the same way
+	for(auto event : PausedEvents)
+	{
+		if ( IsEventFor( event, pTarget, sTargetName, sTargetClassname, sInputName, ich ) )
+		{
+			event->m_flFireTime += flDelta;
+			iCount++;
+		}
+	}
+
+	return iCount;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Moves the target's matching events out of the queue. While parked,
+//			m_flFireTime holds the delay that was left when the event was paused.
+//-----------------------------------------------------------------------------
+int CEventQueue::PauseEvents( CBaseEntity *pTarget, const char *sInputName )
+{
+	if (!pTarget)
+		return 0;
+
+	EventQueuePrioritizedEvent_t *pCur = m_Events.m_pNext;
+	const char* sTargetName = STRING(GetEntityName(pTarget));
+	const char* sTargetClassname = gamehelpers -> GetEntityClassname(pTarget);
+	const char* ich = sInputName ? strchr(sInputName, '*') : NULL;
+	int iCount = 0;
+
+	pCur = SkipDueEvents( pCur );
+	while (pCur != NULL)
+	{
+		EventQueuePrioritizedEvent_t *pCurSave = pCur;
+		pCur = pCur->m_pNext;
+
+		if ( IsEventFor( pCurSave, pTarget, sTargetName, sTargetClassname, sInputName, ich ) )
+		{
+			RemoveEvent( pCurSave );
+			pCurSave->m_flFireTime -= gpGlobals->curtime;
+			pCurSave->m_pNext = NULL;
+			pCurSave->m_pPrev = NULL;
+			PausedEvents.push_back(pCurSave);
+			iCount++;
+		}
+	}
+
+	return iCount;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Puts the target's matching paused events back into the queue with
+//			the delay they had left when they were paused.
+//-----------------------------------------------------------------------------
+int CEventQueue::ResumeEvents( CBaseEntity *pTarget, const char *sInputName )
+{
+	if (!pTarget)
+		return 0;
+
+	const char* sTargetName = STRING(GetEntityName(pTarget));
+	const char* sTargetClassname = gamehelpers -> GetEntityClassname(pTarget);
+	const char* ich = sInputName ? strchr(sInputName, '*') : NULL;
+	AddressPool Resumed;
+
+	for(auto begin = PausedEvents.begin(); begin != PausedEvents.end();)
+	{
+		if ( IsEventFor( *begin, pTarget, sTargetName, sTargetClassname, sInputName, ich ) )
+			Resumed.splice(Resumed.end(), PausedEvents, begin++);
+		else
+			++begin;
+	}
+
+	int iCount = Resumed.size();
+	MergeEvents( MakeResumedChain(Resumed) );
+	return iCount;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Puts every paused event back into the queue
+//-----------------------------------------------------------------------------
+void CEventQueue::ResumeAllEvents()
+{
+	MergeEvents( MakeResumedChain(PausedEvents) );
+	PausedEvents.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Frees every paused event, the engine won't do it for us since they
+//			are not linked into the queue
+//-----------------------------------------------------------------------------
+void CEventQueue::ClearPausedEvents()
+{
+	g_bCancelling = true;
+	while(!PausedEvents.empty())
+	{
+		EventQueuePrioritizedEvent_t* cur_event = PausedEvents.front();
+		PausedEvents.pop_front();
+		delete cur_event;
+	}
+	g_bCancelling = false;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Return the number of events in the queue
+//-----------------------------------------------------------------------------
+int CEventQueue::GetEventCount()
+{
+	int iCount = 0;
+	for ( EventQueuePrioritizedEvent_t *pe = m_Events.m_pNext; pe != NULL; pe = pe->m_pNext )
+	{
+		iCount++;
+	}
+	return iCount;
 }
 
 CEventQueue* g_EventQueue = NULL;
 
+//Copies string parameters, the queue frees them once the event is gone
+inline variant_t MakeVariantCopy(const variant_t& value)
+{
+	variant_t copy = value;
+	if(copy.FieldType() == FIELD_STRING && copy.StringID() != NULL_STRING)
+	{
+		const char* s = STRING(copy.StringID());
+		copy.SetString(MAKE_STRING(MakeStrCopy(s, strlen(s) + 1)));
+	}
+	return copy;
+}
+
+inline variant_t MakeVariantCopy(const char* sParam)
+{
+	variant_t value;
+	if(sParam != NULL)
+		value.SetString(MAKE_STRING(MakeStrCopy(sParam, strlen(sParam) + 1)));
+	return value;
+}
+
+class CEventQueueInterface : public IEventQueue
+{
+public:
+	void AddEvent(CBaseEntity *pTarget, const char *sInput, const char *sParam, float flDelay, CBaseEntity *pActivator, CBaseEntity *pCaller, int iOutputID)
+	{
+		if(!pTarget) return;
+		if(sParam == NULL)
+			g_EventQueue -> AddEvent(pTarget, sInput, flDelay, pActivator, pCaller, iOutputID);
+		else
+			g_EventQueue -> AddEvent(pTarget, sInput, MakeVariantCopy(sParam), flDelay, pActivator, pCaller, iOutputID);
+	}
+
+	void AddEvent(CBaseEntity *pTarget, const char *sInput, const variant_t &value, float flDelay, CBaseEntity *pActivator, CBaseEntity *pCaller, int iOutputID)
+	{
+		if(!pTarget) return;
+		g_EventQueue -> AddEvent(pTarget, sInput, MakeVariantCopy(value), flDelay, pActivator, pCaller, iOutputID);
+	}
+
+	void AddEventByName(const char *sTarget, const char *sInput, const char *sParam, float flDelay, CBaseEntity *pActivator, CBaseEntity *pCaller, int iOutputID)
+	{
+		g_EventQueue -> AddEvent(sTarget, sInput, MakeVariantCopy(sParam), flDelay, pActivator, pCaller, iOutputID);
+	}
+
+	void AddEventByName(const char *sTarget, const char *sInput, const variant_t &value, float flDelay, CBaseEntity *pActivator, CBaseEntity *pCaller, int iOutputID)
+	{
+		g_EventQueue -> AddEvent(sTarget, sInput, MakeVariantCopy(value), flDelay, pActivator, pCaller, iOutputID);
+	}
+
+	void CancelEventOn(CBaseEntity *pTarget, const char *sInput)
+	{
+		g_EventQueue -> CancelEventOn(pTarget, sInput);
+	}
+
+	void CancelEvents(CBaseEntity *pCaller)
+	{
+		g_EventQueue -> CancelEvents(pCaller);
+	}
+
+	bool HasEventPending(CBaseEntity *pTarget, const char *sInput)
+	{
+		return g_EventQueue -> HasEventPending(pTarget, sInput);
+	}
+
+	int HasEventPendingMulti(CBaseEntity **pTargets, int iCount, const char *sInput, bool *pResults)
+	{
+		if(iCount <= 0) return 0;
+		return g_EventQueue -> HasEventPendingMulti(pTargets, iCount, sInput, pResults);
+	}
+
+	int RescheduleEvents(CBaseEntity *pTarget, const char *sInput, float flDelta)
+	{
+		return g_EventQueue -> RescheduleEvents(pTarget, sInput, flDelta);
+	}
+
+	int PauseEvents(CBaseEntity *pTarget, const char *sInput)
+	{
+		return g_EventQueue -> PauseEvents(pTarget, sInput);
+	}
+
+	int ResumeEvents(CBaseEntity *pTarget, const char *sInput)
+	{
+		return g_EventQueue -> ResumeEvents(pTarget, sInput);
+	}
+} g_EventQueueInterface;
+
 cell_t Native_AddEvent(IPluginContext *pContext, const cell_t *params)
 {
 	CBaseEntity* pTarget = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[1]));
@@ -314,14 +813,7 @@ cell_t Native_AddEvent(IPluginContext *pContext, const cell_t *params)
 	CBaseEntity* pActivator = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[5]));
 	CBaseEntity* pCaller = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[6]));
 	int outputID = *(int *)&params[7];
-	if(pParameter == NULL)
-		g_EventQueue -> AddEvent(pTarget, pInputTarget, fDelay, pActivator, pCaller, outputID);
-	else
-	{
-		variant_t value;
-		value.SetString(MAKE_STRING(MakeStrCopy(pParameter, strlen(pParameter) + 1)));
-		g_EventQueue -> AddEvent(pTarget, pInputTarget, value, fDelay, pActivator, pCaller, outputID);
-	}
+	g_EventQueueInterface.AddEvent(pTarget, pInputTarget, pParameter, fDelay, pActivator, pCaller, outputID);
 	return 0;
 }
 
@@ -337,9 +829,7 @@ cell_t Native_AddEventByName(IPluginContext *pContext, const cell_t *params)
 	CBaseEntity* pActivator = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[5]));
 	CBaseEntity* pCaller = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[6]));
 	int outputID = *(int *)&params[7];
-	variant_t Value;
-	if(pParameter != NULL) Value.SetString(MAKE_STRING(MakeStrCopy(pParameter, strlen(pParameter) + 1)));
-	g_EventQueue -> AddEvent(pTarget, pInputTarget, Value, fDelay, pActivator, pCaller, outputID);
+	g_EventQueueInterface.AddEventByName(pTarget, pInputTarget, pParameter, fDelay, pActivator, pCaller, outputID);
 	return 0;
 }
 
@@ -370,6 +860,74 @@ cell_t Native_HasEventPending(IPluginContext *pContext, const cell_t *params)
 	return g_EventQueue -> HasEventPending(pTarget, pInput);
 }
 
+cell_t Native_RescheduleEvents(IPluginContext *pContext, const cell_t *params)
+{
+	CBaseEntity* pTarget = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[1]));
+	if(!pTarget) return 0;
+	char* pInput;
+	pContext->LocalToStringNULL(params[2], &pInput);
+	float fDelta = *(float *)&params[3];
+	if(!std::isfinite(fDelta))
+		return pContext->ThrowNativeError("Invalid delta %f", fDelta);
+	return g_EventQueue -> RescheduleEvents(pTarget, pInput, fDelta);
+}
+
+cell_t Native_PauseEvents(IPluginContext *pContext, const cell_t *params)
+{
+	CBaseEntity* pTarget = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[1]));
+	if(!pTarget) return 0;
+	char* pInput;
+	pContext->LocalToStringNULL(params[2], &pInput);
+	return g_EventQueue -> PauseEvents(pTarget, pInput);
+}
+
+cell_t Native_ResumeEvents(IPluginContext *pContext, const cell_t *params)
+{
+	CBaseEntity* pTarget = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[1]));
+	if(!pTarget) return 0;
+	char* pInput;
+	pContext->LocalToStringNULL(params[2], &pInput);
+	return g_EventQueue -> ResumeEvents(pTarget, pInput);
+}
+
+//The engine clears the queue on round restart too, paused events must not outlive it
+DETOUR_DECL_MEMBER0(CEventQueueClear, void)
+{
+	if((void*)this == (void*)g_EventQueue)
+		g_EventQueue -> ClearPausedEvents();
+	DETOUR_MEMBER_CALL(CEventQueueClear)();
+}
+
+void Hook_LevelShutdown()
+{
+	//Paused events are not in the queue, so the engine won't free them on map change
+	if(g_EventQueue)
+		g_EventQueue -> ClearPausedEvents();
+	RETURN_META(MRES_IGNORED);
+}
+
+cell_t Native_HasEventPendingMulti(IPluginContext *pContext, const cell_t *params)
+{
+	cell_t* pTargets;
+	pContext->LocalToPhysAddr(params[1], &pTargets);
+	int count = params[2];
+	char* pInput;
+	pContext->LocalToStringNULL(params[3], &pInput);
+	cell_t* pResults;
+	pContext->LocalToPhysAddr(params[4], &pResults);
+	if(count <= 0) return 0;
+
+	std::vector<CBaseEntity*> targets(count);
+	for(int i = 0; i < count; i++)
+		targets[i] = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(pTargets[i]));
+
+	std::unique_ptr<bool[]> results(new bool[count]);
+	int pending = g_EventQueue -> HasEventPendingMulti(targets.data(), count, pInput, results.get());
+	for(int i = 0; i < count; i++)
+		pResults[i] = results[i];
+	return pending;
+}
+
 const sp_nativeinfo_t MyNatives[] =
 {
 	{ "EQ_AddEvent", Native_AddEvent },
@@ -377,6 +935,10 @@ const sp_nativeinfo_t MyNatives[] =
 	{ "EQ_CancelEventOn", Native_CancelEventOn },
 	{ "EQ_CancelEvents", Native_CancelEvents },
 	{ "EQ_HasEventPending", Native_HasEventPending },
+	{ "EQ_HasEventPendingMulti", Native_HasEventPendingMulti },
+	{ "EQ_RescheduleEvents", Native_RescheduleEvents },
+	{ "EQ_PauseEvents", Native_PauseEvents },
+	{ "EQ_ResumeEvents", Native_ResumeEvents },
 	{ NULL, NULL }
 };
 
@@ -426,6 +988,38 @@ bool EventQueue::SDK_OnLoad(char *error, size_t maxlength, bool late)
 	}
 	g_EventQueueRemove -> EnableDetour();
 	
+	g_EventQueueAlloc = DETOUR_CREATE_STATIC(CEventQueueAlloc, (void*)EventQueuePrioritizedEvent_t::Alloc);
+	if(g_EventQueueAlloc == NULL)
+	{
+		snprintf(error, maxlength, "Could not create detour for CUtlMemoryPool::Alloc");
+		SDK_OnUnload();
+		return false;
+	}
+	g_EventQueueAlloc -> EnableDetour();
+	g_FlightRecorder.SetDepth(g_EventQueue -> GetEventCount());
+	
+	g_EventQueueClear = DETOUR_CREATE_MEMBER(CEventQueueClear, "CEventQueue::Clear");
+	if(g_EventQueueClear == NULL)
+	{
+		snprintf(error, maxlength, "Could not create detour for CEventQueue::Clear");
+		SDK_OnUnload();
+		return false;
+	}
+	g_EventQueueClear -> EnableDetour();
+	
+	if(!sharesys->AddInterface(myself, &g_EventQueueInterface))
+	{
+		snprintf(error, maxlength, "Could not add IEventQueue interface");
+		SDK_OnUnload();
+		return false;
+	}
+	SH_ADD_HOOK(IServerGameDLL, LevelShutdown, gamedll, SH_STATIC(Hook_LevelShutdown), false);
+	SH_ADD_HOOK(IServerGameDLL, GameFrame, gamedll, SH_STATIC(Hook_GameFrame), false);
+	SH_ADD_HOOK(IServerGameDLL, GameFrame, gamedll, SH_STATIC(Hook_GameFramePost), true);
+	
+	//Registered last, so no failure path above leaves it pointing into an unloaded module
+	ConVar_Register(0, this);
+	
 	g_pEntityList = (CBaseEntityList*)gamehelpers -> GetGlobalEntityList();
 	return true;
 }
@@ -433,9 +1027,16 @@ bool EventQueue::SDK_OnLoad(char *error, size_t maxlength, bool late)
 bool EventQueue::SDK_OnMetamodLoad(ISmmAPI *ismm, char *error, size_t maxlen, bool late)
 {
 	gpGlobals = ismm -> GetCGlobals();
+	GET_V_IFACE_CURRENT(GetEngineFactory, icvar, ICvar, CVAR_INTERFACE_VERSION);
+	g_pCVar = icvar;
 	return true;
 }
 
+bool EventQueue::RegisterConCommandBase(ConCommandBase *pVar)
+{
+	return META_REGCVAR(pVar);
+}
+
 void EventQueue::SDK_OnAllLoaded()
 {
 	sharesys->AddNatives(myself, MyNatives);
@@ -444,7 +1045,18 @@ void EventQueue::SDK_OnAllLoaded()
 
 void EventQueue::SDK_OnUnload()
 {	
+	SH_REMOVE_HOOK(IServerGameDLL, LevelShutdown, gamedll, SH_STATIC(Hook_LevelShutdown), false);
+	
+	//Give paused events back to the engine, ours are unlinked below
+	if(g_EventQueue)
+		g_EventQueue -> ResumeAllEvents();
+	
+	SH_REMOVE_HOOK(IServerGameDLL, GameFrame, gamedll, SH_STATIC(Hook_GameFrame), false);
+	SH_REMOVE_HOOK(IServerGameDLL, GameFrame, gamedll, SH_STATIC(Hook_GameFramePost), true);
+	g_FlightRecorder.SetEnabled(false);
+	
 	//Remove all events added by this extension
+	g_bCancelling = true;
 	while(!EventData.empty())
 	{
 		EventQueuePrioritizedEvent_t* cur_event = EventData.front();
@@ -455,12 +1067,24 @@ void EventQueue::SDK_OnUnload()
 		}
 		delete cur_event;	//Here we call our detour to handle this event properly
 	}
+	g_bCancelling = false;
 
 	if(g_EventQueueRemove != NULL)
 	{
 		g_EventQueueRemove -> Destroy();
 		g_EventQueueRemove = NULL;
 	}
+	if(g_EventQueueAlloc != NULL)
+	{
+		g_EventQueueAlloc -> Destroy();
+		g_EventQueueAlloc = NULL;
+	}
+	if(g_EventQueueClear != NULL)
+	{
+		g_EventQueueClear -> Destroy();
+		g_EventQueueClear = NULL;
+	}
+	ConVar_Unregister();
 	g_EventQueue = NULL;
 	gameconfs->CloseGameConfigFile(g_pGameConf);
 	g_pEntityList = NULL;
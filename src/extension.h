@@ -38,13 +38,14 @@
  */
 
 #include "smsdk_ext.h"
+#include <convar.h>
 
 
 /**
  * @brief Sample implementation of the SDK Extension.
  * Note: Uncomment one of the pre-defined virtual functions in order to use it.
  */
-class EventQueue: public SDKExtension
+class EventQueue: public SDKExtension, public IConCommandBaseAccessor
 {
 public:
 	/**
@@ -114,6 +115,8 @@ public:
 	 */
 	//virtual bool SDK_OnMetamodPauseChange(bool paused, char *error, size_t maxlen);
 #endif
+public: //IConCommandBaseAccessor
+	virtual bool RegisterConCommandBase(ConCommandBase *pVar);
 };
 
 #endif // _INCLUDE_SOURCEMOD_EXTENSION_PROPER_H_
@@ -0,0 +1,103 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Entity Events Queue
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flightrecorder.h"
+#include <stdio.h>
+#include <time.h>
+
+CFlightRecorder g_FlightRecorder;
+
+static const char *g_szOpNames[] =
+{
+	"add",
+	"cancel",
+	"dispatch",
+	"frame",
+};
+
+void CFlightRecorder::SetEnabled(bool bEnabled)
+{
+	if(bEnabled == m_bEnabled)
+		return;
+
+	//Start from an empty buffer so a dump never shows records from a previous session
+	m_iHead.store(0, std::memory_order_relaxed);
+	m_bEnabled = bEnabled;
+}
+
+void CFlightRecorder::OnFrame(float flFrameMs, float flThresholdMs, double flNow)
+{
+	Record(FlightRecorder_Frame, -1, NULL, NULL, flFrameMs);
+
+	if(flFrameMs < flThresholdMs)
+		return;
+
+	//Dumping is slow, don't let a run of slow frames turn into a run of dumps
+	if(m_flLastDump > 0.0 && flNow - m_flLastDump < FLIGHTRECORDER_DUMP_GAP)
+		return;
+
+	m_flLastDump = flNow;
+	Dump(flFrameMs, flThresholdMs);
+
+	//Only show what happened since this spike on the next one
+	m_iHead.store(0, std::memory_order_relaxed);
+}
+
+bool CFlightRecorder::Dump(float flFrameMs, float flThresholdMs)
+{
+	char date[32];
+	time_t t = time(NULL);
+	strftime(date, sizeof(date), "%Y%m%d_%H%M%S", localtime(&t));
+
+	char path[PLATFORM_MAX_PATH];
+	smutils->BuildPath(Path_SM, path, sizeof(path), "logs/eventqueue_spike_%s.log", date);
+
+	FILE *fp = fopen(path, "a");
+	if(!fp)
+	{
+		smutils->LogError(myself, "Could not open %s for writing", path);
+		return false;
+	}
+
+	uint32_t head = m_iHead.load(std::memory_order_relaxed);
+	uint32_t count = head < FLIGHTRECORDER_SIZE ? head : FLIGHTRECORDER_SIZE;
+
+	fprintf(fp, "Frame took %.3f ms (threshold %.3f ms) on %s, last %u queue operations:\n",
+		flFrameMs, flThresholdMs, STRING(gpGlobals->mapname), count);
+
+	for(uint32_t i = head - count; i != head; i++)
+	{
+		const FlightRecord_t &rec = m_Records[i & (FLIGHTRECORDER_SIZE - 1)];
+		if(rec.m_Op == FlightRecorder_Frame)
+		{
+			fprintf(fp, "[%d %.3f] %-8s depth=%d time=%.3fms\n",
+				rec.m_iTick, rec.m_flTime, g_szOpNames[rec.m_Op], rec.m_iDepth, rec.m_flValue);
+		}
+		else
+		{
+			fprintf(fp, "[%d %.3f] %-8s depth=%d fire=%.3f target=%s(%d) input=%s\n",
+				rec.m_iTick, rec.m_flTime, g_szOpNames[rec.m_Op], rec.m_iDepth, rec.m_flValue,
+				rec.m_szTarget, rec.m_iTarget, rec.m_szInput);
+		}
+	}
+
+	fclose(fp);
+	smutils->LogMessage(myself, "Frame took %.3f ms, event queue activity written to %s", flFrameMs, path);
+	return true;
+}
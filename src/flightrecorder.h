@@ -0,0 +1,131 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Entity Events Queue
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _INCLUDE_EVENTQUEUE_FLIGHTRECORDER_H_
+#define _INCLUDE_EVENTQUEUE_FLIGHTRECORDER_H_
+
+/**
+ * @file flightrecorder.h
+ * @brief Fixed-size ring buffer of recent event queue operations, dumped to a file on frame spikes.
+ */
+
+#include "smsdk_ext.h"
+#include <atomic>
+#include <stdint.h>
+
+#define FLIGHTRECORDER_SIZE		4096	/**< Number of records kept, must be a power of two */
+#define FLIGHTRECORDER_NAMELEN	32		/**< Target and input names are truncated to this */
+#define FLIGHTRECORDER_DUMP_GAP	10.0	/**< Minimum seconds between two dumps */
+
+extern CGlobalVars *gpGlobals;
+
+enum FlightRecorderOp_t : uint8_t
+{
+	FlightRecorder_Add = 0,		/**< Event added by this extension */
+	FlightRecorder_Cancel,		/**< Event freed by this extension */
+	FlightRecorder_Dispatch,	/**< Event freed by the engine, either fired or cancelled by game logic */
+	FlightRecorder_Frame,		/**< End of a server frame */
+};
+
+struct FlightRecord_t
+{
+	float m_flTime;			/**< gpGlobals->curtime */
+	int m_iTick;			/**< gpGlobals->tickcount */
+	int m_iDepth;			/**< Live events (queued and paused) after the operation */
+	int m_iTarget;			/**< Target entity index, -1 when targeted by name */
+	float m_flValue;		/**< Fire time for events, frame time in ms for frames */
+	FlightRecorderOp_t m_Op;
+	char m_szTarget[FLIGHTRECORDER_NAMELEN];
+	char m_szInput[FLIGHTRECORDER_NAMELEN];
+};
+
+class CFlightRecorder
+{
+public:
+	CFlightRecorder() : m_iHead(0), m_iDepth(0), m_bEnabled(false), m_flLastDump(0.0) {}
+
+	inline bool IsEnabled() const { return m_bEnabled; }
+	void SetEnabled(bool bEnabled);
+
+	/**
+	 * @brief Queue depth is tracked even while disabled so it is correct once enabled.
+	 */
+	inline void SetDepth(int iDepth) { m_iDepth = iDepth; }
+	inline void OnAlloc() { m_iDepth++; }
+	inline void OnFree() { m_iDepth--; }
+
+	/**
+	 * @brief Stores one operation in the ring buffer. Never allocates or locks.
+	 */
+	inline void Record(FlightRecorderOp_t op, int iTarget, const char *sTarget, const char *sInput, float flValue)
+	{
+		if(!m_bEnabled)
+			return;
+
+		FlightRecord_t &rec = m_Records[m_iHead.fetch_add(1, std::memory_order_relaxed) & (FLIGHTRECORDER_SIZE - 1)];
+		rec.m_flTime = gpGlobals->curtime;
+		rec.m_iTick = gpGlobals->tickcount;
+		rec.m_iDepth = m_iDepth;
+		rec.m_iTarget = iTarget;
+		rec.m_flValue = flValue;
+		rec.m_Op = op;
+		CopyName(rec.m_szTarget, sTarget);
+		CopyName(rec.m_szInput, sInput);
+	}
+
+	/**
+	 * @brief Records the end of a frame and dumps the buffer if it took too long,
+	 * at most once every FLIGHTRECORDER_DUMP_GAP seconds.
+	 *
+	 * @param flFrameMs		Time spent in the frame in milliseconds.
+	 * @param flThresholdMs	Spike threshold in milliseconds.
+	 * @param flNow			Plat_FloatTime() at the end of the frame.
+	 */
+	void OnFrame(float flFrameMs, float flThresholdMs, double flNow);
+
+	/**
+	 * @brief Writes the buffer, oldest record first, to a new file in the SourceMod logs folder.
+	 *
+	 * @return				True if the file was written, false otherwise.
+	 */
+	bool Dump(float flFrameMs, float flThresholdMs);
+
+private:
+	static inline void CopyName(char *dest, const char *src)
+	{
+		size_t i = 0;
+		if(src)
+		{
+			for(; i < FLIGHTRECORDER_NAMELEN - 1 && src[i]; i++)
+				dest[i] = src[i];
+		}
+		dest[i] = '\0';
+	}
+
+private:
+	FlightRecord_t m_Records[FLIGHTRECORDER_SIZE];
+	std::atomic<uint32_t> m_iHead;
+	int m_iDepth;
+	bool m_bEnabled;
+	double m_flLastDump;
+};
+
+extern CFlightRecorder g_FlightRecorder;
+
+#endif // _INCLUDE_EVENTQUEUE_FLIGHTRECORDER_H_